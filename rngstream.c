@@ -12,6 +12,15 @@
 #include <stdio.h>
 #include "rngstream.h"
 
+#define RNG_SHUFFLE_BLOCK 256 //Number of bounded deviates generated ahead of the swaps
+#define RNG_PREFETCH_DIST 16  //Prefetch distance, in number of swaps
+
+#if defined(__GNUC__)
+#define RNG_PREFETCH_W(p) __builtin_prefetch((p),1)
+#else
+#define RNG_PREFETCH_W(p)
+#endif
+
 //-------------------------------------------------------------------------
 // The default seed of the package; will be the seed of the first
 // declared RNGStream, unless SetPackageSeed is called.
@@ -139,6 +148,229 @@ void rng_writestatefull(rng_stream* s)
   printf("%" PRIu64 " }\n\n",s->Cg[5]);
 }
 
+//-------------------------------------------------------------------------
+// Swap two elements of size bytes. Works also when a = b.
+//
+inline static void rng_swap(char* a, char* b, size_t size)
+{
+  switch(size) {
+    case 4: {
+      uint32_t t;
+      memcpy(&t,a,4); memmove(a,b,4); memcpy(b,&t,4);
+      return;
+    }
+    case 8: {
+      uint64_t t;
+      memcpy(&t,a,8); memmove(a,b,8); memcpy(b,&t,8);
+      return;
+    }
+    default: {
+      char t[64];
+      size_t c;
+
+      for(; size; size-=c, a+=c, b+=c) {
+	c=(size<64?size:64);
+	memcpy(t,a,c); memmove(a,b,c); memcpy(b,t,c);
+      }
+    }
+  }
+}
+
+//-------------------------------------------------------------------------
+void rng_shuffle(rng_stream* s, void* base, const size_t n, const size_t size)
+{
+  uint64_t idx[RNG_SHUFFLE_BLOCK];
+  char* const b=(char*)base;
+  size_t i;
+  int k, cnt;
+
+  if(n<2 || !size) return;
+
+  // Swap element i with a uniformly chosen element in [0,i], for i = n-1 down to 1
+  for(i=n-1; i>0; i-=cnt) {
+    cnt=(i<RNG_SHUFFLE_BLOCK?i:RNG_SHUFFLE_BLOCK);
+
+    for(k=0; k<cnt; ++k) idx[k]=rng_rand_bounded(s,i-k+1);
+
+    for(k=(cnt<RNG_PREFETCH_DIST?cnt:RNG_PREFETCH_DIST)-1; k>=0; --k) RNG_PREFETCH_W(b+idx[k]*size);
+
+    for(k=0; k<cnt; ++k) {
+      if(k+RNG_PREFETCH_DIST<cnt) RNG_PREFETCH_W(b+idx[k+RNG_PREFETCH_DIST]*size);
+      rng_swap(b+(i-k)*size,b+idx[k]*size,size);
+    }
+  }
+}
+
+//-------------------------------------------------------------------------
+// Elements are first scattered from a copy of the array into nblocks
+// buckets, the bucket of each element being drawn from the substream of its
+// source block. The draws are regenerated for the scatter pass by resetting
+// the substreams, to avoid storing them. Each bucket is then shuffled in
+// place with its own substream.
+//
+bool rng_shuffle_par(rng_stream* s, void* base, const size_t n, const size_t size, const unsigned nblocks)
+{
+  if(nblocks<2) {
+    rng_shuffle(s,base,n,size);
+    return true;
+  }
+  char* const b=(char*)base;
+  const size_t nb=nblocks;
+  char* tmp=(char*)malloc(n*size);
+  size_t* off=(size_t*)malloc((nb*nb+nb+1)*sizeof(size_t)); // off[j*nb+l] for source block j and bucket l, followed by the bucket boundaries
+  rng_stream* st=(rng_stream*)malloc(2*nb*sizeof(rng_stream)); // Block substreams followed by bucket substreams
+  size_t* bnd;
+  rng_stream t=*s;
+  long j;
+  size_t i, l, pos;
+
+  if(!tmp || !off || !st) {
+    free(tmp); free(off); free(st);
+    return false;
+  }
+  bnd=off+nb*nb;
+
+  for(i=0; i<2*nb; ++i) {
+    rng_resetnextsubstream(&t);
+    st[i]=t;
+    st[i].favail8=st[i].favail16=0;
+  }
+  memcpy(s->Bg,t.Bg,6*sizeof(uint64_t));
+  rng_resetnextsubstream(s);
+  s->favail8=s->favail16=0;
+
+  memset(off,0,nb*nb*sizeof(size_t));
+  memcpy(tmp,b,n*size);
+
+  // Count the number of elements from each source block going to each bucket
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic)
+#endif
+  for(j=0; j<(long)nb; ++j) {
+    const size_t end=(j+1)*n/nb;
+
+    for(i=j*n/nb; i<end; ++i) ++off[j*nb+rng_rand_bounded32(st+j,nblocks)];
+    rng_resetstartsubstream(st+j);
+    st[j].favail8=st[j].favail16=0;
+  }
+
+  // Convert counts into destination offsets, ordered by bucket and then by source block
+  for(pos=0, l=0; l<nb; ++l) {
+    bnd[l]=pos;
+
+    for(i=0; i<nb; ++i) {
+      const size_t c=off[i*nb+l];
+      off[i*nb+l]=pos;
+      pos+=c;
+    }
+  }
+  bnd[nb]=pos;
+
+  // Scatter the elements into the buckets
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic)
+#endif
+  for(j=0; j<(long)nb; ++j) {
+    const size_t end=(j+1)*n/nb;
+    size_t* const o=off+j*nb;
+
+    for(i=j*n/nb; i<end; ++i) memcpy(b+(o[rng_rand_bounded32(st+j,nblocks)]++)*size,tmp+i*size,size);
+  }
+  free(tmp);
+
+  // Shuffle each bucket
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for(j=0; j<(long)nb; ++j) rng_shuffle(st+nb+j,b+bnd[j]*size,bnd[j+1]-bnd[j],size);
+
+  free(off);
+  free(st);
+  return true;
+}
+
+//-------------------------------------------------------------------------
+// Insert v in the bitmap or in the open addressing hash set (storing v+1,
+// with 0 for empty slots). Returns false if v was already present.
+//
+inline static bool rng_bitmapinsert(uint64_t* const bits, const uint64_t v)
+{
+  const uint64_t m=UINT64_C(1)<<(v&63);
+
+  if(bits[v>>6]&m) return false;
+  bits[v>>6]|=m;
+  return true;
+}
+
+inline static uint64_t rng_hashslot(const uint64_t v, const int shift){return (v*UINT64_C(0x9E3779B97F4A7C15))>>shift;}
+
+inline static bool rng_hashinsert(uint64_t* const set, const uint64_t mask, const int shift, const uint64_t v)
+{
+  uint64_t h=rng_hashslot(v,shift);
+
+  while(set[h]) {
+    if(set[h]==v+1) return false;
+    h=(h+1)&mask;
+  }
+  set[h]=v+1;
+  return true;
+}
+
+//-------------------------------------------------------------------------
+bool rng_sample_k(rng_stream* s, const uint64_t n, const uint64_t k, uint64_t* const out)
+{
+  uint64_t idx[RNG_SHUFFLE_BLOCK];
+  uint64_t* set;
+  uint64_t mask=0, j, o=0, v;
+  int shift=0, c, cnt;
+  const bool usebitmap=(n/64<=2*k);
+
+  if(k>n) return false;
+  if(!k) return true;
+
+  if(usebitmap) set=(uint64_t*)calloc((n+63)/64,sizeof(uint64_t));
+
+  else {
+    // Table with a load factor between 1/4 and 1/2
+    for(shift=63, mask=2; mask<2*k; mask<<=1) --shift;
+    set=(uint64_t*)calloc(mask,sizeof(uint64_t));
+    --mask;
+  }
+
+  if(!set) return false;
+
+  // Floyd's algorithm: for j = n-k to n-1, pick v in [0,j] and insert it, or j if v was already selected
+  for(j=n-k; j<n; j+=cnt) {
+    cnt=(n-j<RNG_SHUFFLE_BLOCK?n-j:RNG_SHUFFLE_BLOCK);
+
+    for(c=0; c<cnt; ++c) idx[c]=rng_rand_bounded(s,j+c+1);
+
+    for(c=(cnt<RNG_PREFETCH_DIST?cnt:RNG_PREFETCH_DIST)-1; c>=0; --c) RNG_PREFETCH_W(usebitmap?set+(idx[c]>>6):set+rng_hashslot(idx[c],shift));
+
+    if(usebitmap)
+
+      for(c=0; c<cnt; ++c) {
+	if(c+RNG_PREFETCH_DIST<cnt) RNG_PREFETCH_W(set+(idx[c+RNG_PREFETCH_DIST]>>6));
+	v=idx[c];
+
+	if(!rng_bitmapinsert(set,v)) rng_bitmapinsert(set,v=j+c);
+	out[o++]=v;
+      }
+
+    else
+
+      for(c=0; c<cnt; ++c) {
+	if(c+RNG_PREFETCH_DIST<cnt) RNG_PREFETCH_W(set+rng_hashslot(idx[c+RNG_PREFETCH_DIST],shift));
+	v=idx[c];
+
+	if(!rng_hashinsert(set,mask,shift,v)) rng_hashinsert(set,mask,shift,v=j+c);
+	out[o++]=v;
+      }
+  }
+  free(set);
+  return true;
+}
+
 //-------------------------------------------------------------------------
 // Compute the vector v = A*s MOD m. Assume that -m < s[i] < m.
 // Works also when v = s.
@@ -113,6 +113,9 @@ void rng_advancestate(rng_stream* s, const long e, const long c);
 inline static void rng_getstate(rng_stream* s, uint64_t* const seed){memcpy(seed,s->Cg,6*sizeof(uint64_t));}
 void rng_writestate(rng_stream* s);
 void rng_writestatefull(rng_stream* s);
+void rng_shuffle(rng_stream* s, void* base, const size_t n, const size_t size);
+bool rng_shuffle_par(rng_stream* s, void* base, const size_t n, const size_t size, const unsigned nblocks);
+bool rng_sample_k(rng_stream* s, const uint64_t n, const uint64_t k, uint64_t* const out);
 
 /**
  * @brief Uniform deviate in the interval [0,m1-1], with m1=4294967087.
@@ -367,6 +370,140 @@ inline static double rng_rand_pu01d(_rng_stream *s){return rng_rand_m1(s)*0x1.00
 //inline static double rng_rand_pu01d(rng_stream *s){double ret=rng_rand_u01d(s); while(ret==0) ret=rng_rand_u01d(s); return ret;}
 //inline static double rng_rand_pu01d(rng_stream *s){return (rng_rand_m1(s)+rng_rand_pm1(s)*0x1.000000d10000bp-32)*0x1.000000d10000bp-32;}
 
+/**
+ * @brief Uniform deviate in the interval [0,range-1], with range<=2^32.
+ *
+ * This function returns an unbiased uniform deviate in the interval
+ * [0,range-1] using Lemire's nearly divisionless multiply-shift method on
+ * rng_rand32. A modulo operation is only needed when the low product bits
+ * fall in the rejection zone, and a new draw is only needed with a
+ * probability of less than range/2^32. range must be non-zero.
+ *
+ * @param s: Handle to rng_stream.
+ * @param range: Number of possible values.
+ * @return uniform deviate in the interval [0,range-1].
+ */
+inline static uint32_t rng_rand_bounded32(_rng_stream *s, const uint32_t range){
+  uint64_t m=(uint64_t)rng_rand32(s)*range;
+  uint32_t l=(uint32_t)m;
+
+  if(l<range) {
+    const uint32_t t=-range%range;
+
+    while(l<t) {
+      m=(uint64_t)rng_rand32(s)*range;
+      l=(uint32_t)m;
+    }
+  }
+  return m>>32;
+}
+
+/**
+ * @brief Uniform deviate in the interval [0,range-1], with range<2^64.
+ *
+ * This function returns an unbiased uniform deviate in the interval
+ * [0,range-1] using the same method as rng_rand_bounded32, but on rng_rand64.
+ * When 128 bit integers are not available, bit mask rejection sampling is
+ * used instead. range must be non-zero.
+ *
+ * @param s: Handle to rng_stream.
+ * @param range: Number of possible values.
+ * @return uniform deviate in the interval [0,range-1].
+ */
+inline static uint64_t rng_rand_bounded64(_rng_stream *s, const uint64_t range){
+#ifdef __SIZEOF_INT128__
+  __uint128_t m=(__uint128_t)rng_rand64(s)*range;
+  uint64_t l=(uint64_t)m;
+
+  if(l<range) {
+    const uint64_t t=-range%range;
+
+    while(l<t) {
+      m=(__uint128_t)rng_rand64(s)*range;
+      l=(uint64_t)m;
+    }
+  }
+  return m>>64;
+#else
+  uint64_t mask=range-1, r;
+  mask|=mask>>1; mask|=mask>>2; mask|=mask>>4; mask|=mask>>8; mask|=mask>>16; mask|=mask>>32;
+
+  do r=rng_rand64(s)&mask; while(r>=range);
+  return r;
+#endif
+}
+
+/**
+ * @brief Uniform deviate in the interval [0,range-1].
+ *
+ * This function calls rng_rand_bounded32 whenever range fits in 32 bits and
+ * rng_rand_bounded64 otherwise. range must be non-zero.
+ *
+ * @param s: Handle to rng_stream.
+ * @param range: Number of possible values.
+ * @return uniform deviate in the interval [0,range-1].
+ */
+inline static uint64_t rng_rand_bounded(_rng_stream *s, const uint64_t range){return (range<=UINT32_MAX?rng_rand_bounded32(s,(uint32_t)range):rng_rand_bounded64(s,range));}
+
+/**
+ * @fn void rng_shuffle(rng_stream* s, void* base, const size_t n, const size_t size)
+ * @brief Random permutation of an array.
+ *
+ * This function shuffles in place the n elements of size bytes pointed by base
+ * using the Fisher-Yates algorithm. Swap indices are generated in blocks ahead
+ * of the swaps, such that the memory locations of the upcoming swaps can be
+ * prefetched while the current ones are performed.
+ *
+ * @param s: Handle to rng_stream.
+ * @param base: Pointer to the first element of the array.
+ * @param n: Number of elements in the array.
+ * @param size: Size of each element, in bytes.
+ */
+
+/**
+ * @fn bool rng_shuffle_par(rng_stream* s, void* base, const size_t n, const size_t size, const unsigned nblocks)
+ * @brief Deterministic parallel random permutation of an array.
+ *
+ * This function shuffles in place the n elements of size bytes pointed by base.
+ * The array is divided in nblocks contiguous blocks, and each element is
+ * first scattered to one of nblocks buckets chosen uniformly, using one
+ * independent substream per block. Each bucket is then shuffled with
+ * rng_shuffle, using one independent substream per bucket. The blocks and
+ * buckets are processed in parallel when compiled with OpenMP support. The
+ * result only depends on the state of s and on nblocks, and not on the number
+ * of threads. The 2*nblocks substreams following the current substream of s
+ * are used and s is then moved to the start of the next substream. If nblocks
+ * is lower than 2, rng_shuffle is called instead. This function requires a
+ * temporary buffer of n*size bytes.
+ *
+ * @param s: Handle to rng_stream.
+ * @param base: Pointer to the first element of the array.
+ * @param n: Number of elements in the array.
+ * @param size: Size of each element, in bytes.
+ * @param nblocks: Number of blocks.
+ * @return true on success, false if memory allocation failed.
+ */
+
+/**
+ * @fn bool rng_sample_k(rng_stream* s, const uint64_t n, const uint64_t k, uint64_t* const out)
+ * @brief Random sampling of k distinct values from [0,n-1].
+ *
+ * This function stores in out k distinct values uniformly sampled without
+ * replacement from the interval [0,n-1], using Floyd's algorithm. Membership
+ * is tracked with a bitmap of n bits when k is large relative to n, and with
+ * an open addressing hash set of at most 4*k entries otherwise. Bounded
+ * deviates are generated in blocks ahead of the membership tests, such that
+ * the corresponding memory locations can be prefetched. Every k-subset is
+ * equally likely, but the order of the values in out is not uniformly random.
+ * rng_shuffle can be called on out if a random order is needed.
+ *
+ * @param s: Handle to rng_stream.
+ * @param n: Number of possible values.
+ * @param k: Number of values to sample.
+ * @param out: Output array of at least k elements.
+ * @return true on success, false if k>n or if memory allocation failed.
+ */
+
 #endif
 
 